@@ -5,6 +5,12 @@
 
 #include <ncnn/net.h>
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #define THRESGOLD 2.5
 
 struct FaceObjectMesh
@@ -22,21 +28,50 @@ enum ORIENTATION_t
     ORIENTATION_RIGHT       = 2,
 };
 
+enum SHM_PROCESS_t
+{
+    SHM_PROCESS_BAD_FRAME   = -2,   // frame header does not fit its slot, the frame was dropped
+    SHM_PROCESS_ERROR       = -1,   // result ring slots are too small for ShmFaceResult
+    SHM_PROCESS_IDLE        = 0,    // no frame pending
+    SHM_PROCESS_DONE        = 1,    // one frame consumed and its result published
+    SHM_PROCESS_BUSY        = 2,    // result ring full, the frame stays pending
+};
+
+struct FaceAnalysis
+{
+    std::vector<cv::Point2f> landmarks; // 468 mesh points in frame coordinates
+    cv::Mat mask;                       // 256x256 face part labels
+    cv::Rect mask_box;                  // frame region the mask covers
+    bool has_mask = false;              // false when seg was skipped (no faceseg model, empty box), mask is then all zero
+};
+
+class ShmRing;
+struct MeshModelInfo;
+
 class FaceMeshService
 {
 public:
     FaceMeshService();
     ~FaceMeshService();
-    int load(const char *modeltype);
+    // modeltype: scrfd variant ("500m", "1g"), meshtype: facemesh variant ("op", "op2" unverified)
+    int load(const char *modeltype, const char *modeldir = "../Pkg/FaceMesh/models", const char *meshtype = "op");
+    bool hasSeg() const;
 
     int detect(const cv::Mat &rgb, std::vector<FaceObjectMesh> &faceobjects, float prob_threshold = 0.5f, float nms_threshold = 0.45f);
 
     int draw(cv::Mat &rgb, const std::vector<FaceObjectMesh> &faceobjects);
     void seg(cv::Mat &rgb, const FaceObjectMesh &obj, cv::Mat &mask, cv::Rect &box);
     void landmark(cv::Mat &rgb, const FaceObjectMesh &obj, std::vector<cv::Point2f> &landmarks);
+    // landmark + seg for one face, both crops read in place and the two nets run concurrently
+    // (without faceseg weights only facept runs, on every core), same outputs as landmark() + seg()
+    void analyze(const cv::Mat &rgb, const FaceObjectMesh &obj, FaceAnalysis &result);
 
     ORIENTATION_t detectFacialOrientation(const cv::Mat &img);
 
+    // consume one frame from a shared memory ring and publish its faces (and mesh) to another
+    // never blocks, a service loop sleeps in frames.waitRead() until it returns something else than IDLE
+    SHM_PROCESS_t processShm(ShmRing &frames, ShmRing &results, bool with_mesh = true, float prob_threshold = 0.5f, float nms_threshold = 0.45f);
+
     static FaceMeshService* getInstance();
 
 private:
@@ -46,6 +81,24 @@ private:
     ncnn::Net faceseg;
     ncnn::Net scrfd;
     bool has_kps = false;
+    bool has_seg = false;
+    const MeshModelInfo *mesh_model = nullptr;
+
+    // num_threads 0 keeps the net's own opt.num_threads
+    bool segInfer(ncnn::Mat &ncnn_in, cv::Mat &mask, int num_threads = 0);
+    void meshInfer(ncnn::Mat &ncnn_in, const cv::Rect &box, std::vector<cv::Point2f> &landmarks, int num_threads = 0);
+
+    // core split and helper thread used by analyze()
+    int mesh_threads = 1;
+    int seg_threads = 1;
+    std::mutex analyze_mutex;
+    std::thread worker;
+    std::mutex worker_mutex;
+    std::condition_variable worker_cv;
+    std::function<void()> worker_job;
+    bool worker_done = false;
+    bool worker_stop = false;
+    void workerLoop();
     
     FaceMeshService(FaceMeshService const&) = delete;
     void operator=(FaceMeshService const&) = delete;
@@ -0,0 +1,81 @@
+#ifndef SHMFACEIO_H
+#define SHMFACEIO_H
+
+#include <opencv2/core/core.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FaceMeshService.h"
+
+#define SHM_MAX_FACES 8
+#define SHM_MESH_POINTS 468
+
+// layout of a frame slot: header followed by tightly packed RGB pixels
+struct ShmFrameInfo
+{
+    int32_t width;
+    int32_t height;
+    int32_t step;
+    int32_t reserved;
+};
+
+// layout of a result slot, published with the sequence number of its frame
+struct ShmFaceResult
+{
+    uint64_t frame_seq;
+    int32_t face_count;     // faces stored in this slot
+    int32_t detected_count; // faces detected, larger than face_count when truncated to SHM_MAX_FACES
+    int32_t has_mesh;
+    int32_t reserved;
+    FaceObjectMesh faces[SHM_MAX_FACES];
+    cv::Point2f mesh[SHM_MAX_FACES][SHM_MESH_POINTS];
+};
+
+static inline size_t shmFrameSlotSize(int max_width, int max_height)
+{
+    return sizeof(ShmFrameInfo) + (size_t)max_width * max_height * 3;
+}
+
+// detect() reads the pixels without a stride, so only tightly packed frames that fit the slot are valid
+static inline bool shmFrameFits(int width, int height, int step, size_t slot_size)
+{
+    if (width <= 0 || height <= 0 || width > INT32_MAX / 3 || step != width * 3)
+        return false;
+
+    if (slot_size < sizeof(ShmFrameInfo))
+        return false;
+
+    return (uint64_t)step * (uint64_t)height <= (uint64_t)(slot_size - sizeof(ShmFrameInfo));
+}
+
+// writable view over a frame slot, the producer decodes / converts straight into it
+// returns an empty Mat when the frame does not fit the slot
+static inline cv::Mat shmFrameWriteView(void *slot, size_t slot_size, int width, int height)
+{
+    if (width <= 0 || width > INT32_MAX / 3 || !shmFrameFits(width, height, width * 3, slot_size))
+        return cv::Mat();
+
+    ShmFrameInfo *info = (ShmFrameInfo *)slot;
+    info->width = width;
+    info->height = height;
+    info->step = width * 3;
+    info->reserved = 0;
+    return cv::Mat(height, width, CV_8UC3, (uint8_t *)slot + sizeof(ShmFrameInfo), info->step);
+}
+
+// read view over a frame slot, only valid until ShmRing::endRead()
+// returns an empty Mat when the header written by the producer is bad
+static inline cv::Mat shmFrameReadView(const void *slot, size_t slot_size)
+{
+    const ShmFrameInfo *info = (const ShmFrameInfo *)slot;
+    int width = info->width;
+    int height = info->height;
+    int step = info->step;
+    if (!shmFrameFits(width, height, step, slot_size))
+        return cv::Mat();
+
+    return cv::Mat(height, width, CV_8UC3, (uint8_t *)slot + sizeof(ShmFrameInfo), step);
+}
+
+#endif // SHMFACEIO_H
@@ -0,0 +1,57 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer / single-consumer ring of fixed size slots living in POSIX
+// shared memory. Slots are handed out in place, so writer and reader touch the
+// same pages and nothing is copied between processes.
+class ShmRing
+{
+public:
+    ShmRing();
+    ~ShmRing();
+
+    // fails if the name already exists, unlink a stale segment with ShmRing::unlink() first
+    int create(const char *name, uint32_t slot_count, size_t slot_size);
+    int open(const char *name);
+    void close();
+
+    static int unlink(const char *name);
+
+    // writer side: returns nullptr when the ring is full
+    void *beginWrite();
+    uint64_t endWrite();
+
+    // reader side: returns nullptr when the ring is empty
+    const void *beginRead(uint64_t &seq);
+    void endRead();
+
+    // blocking beginWrite() / beginRead(): sleep until a slot is free / a frame is pending,
+    // at most timeout_ms (-1 waits forever), nullptr on timeout. Nothing is consumed, the
+    // matching endWrite() / endRead() is still needed, so waitRead() can front processShm()
+    void *waitWrite(int timeout_ms);
+    const void *waitRead(uint64_t &seq, int timeout_ms);
+
+    size_t slotSize() const;
+    uint32_t slotCount() const;
+
+private:
+    struct Control;
+
+    uint8_t *slot(uint64_t index) const;
+
+    Control *ctrl;
+    size_t map_size;
+    size_t slot_stride;
+    uint32_t slots;
+    size_t slot_bytes;
+    bool owner;
+    char shm_name[256];
+
+    ShmRing(ShmRing const&) = delete;
+    void operator=(ShmRing const&) = delete;
+};
+
+#endif // SHMRING_H
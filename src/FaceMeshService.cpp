@@ -1,4 +1,6 @@
 #include "../inc/FaceMeshService.h"
+#include "../inc/ShmRing.h"
+#include "../inc/ShmFaceIO.h"
 
 #include <string.h>
 #include <opencv2/core/core.hpp>
@@ -9,6 +11,9 @@
 
 #include <iostream>
 #include <mutex>
+#include <thread>
+#include <functional>
+#include <algorithm>
 
 FaceMeshService *FaceMeshService::m_instance = nullptr;
 std::mutex FaceMeshService::m_ctx;
@@ -237,19 +242,101 @@ FaceMeshService *FaceMeshService::getInstance()
 
 FaceMeshService::~FaceMeshService()
 {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        worker_stop = true;
+    }
+    worker_cv.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+// persistent helper thread for analyze(), runs one job at a time
+void FaceMeshService::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    while (true)
+    {
+        worker_cv.wait(lock, [this]() { return worker_stop || worker_job; });
+        if (!worker_job)
+            return;
+
+        std::function<void()> job = std::move(worker_job);
+        worker_job = nullptr;
+        lock.unlock();
+        job();
+        lock.lock();
+        worker_done = true;
+        worker_cv.notify_all();
+    }
 }
 
-int FaceMeshService::load(const char *modeltype)
+// mesh model variants, facemesh-op regresses pixel coords of a 192 input (x, y, z per point),
+// facemesh-op2 is a 112 input PFLD style head regressing normalized (x, y); its mean / norm are
+// not confirmed against the original model, so it is kept out of the golden / perf tests
+struct MeshModelInfo
+{
+    const char *name;
+    const char *input;
+    const char *output;
+    int size;
+    int stride;
+    float coord_scale;
+    float mean;
+    float norm;
+};
+
+static const MeshModelInfo mesh_models[] = {
+    {"op", "input.1", "482", 192, 3, 192.f, 127.5f, 1 / 127.5f},
+    {"op2", "input", "output", 112, 2, 1.f, 0.f, 1 / 255.f},
+};
+
+int FaceMeshService::load(const char *modeltype, const char *modeldir, const char *meshtype)
 {
     this->scrfd.clear();
+    this->facept.clear();
+    this->faceseg.clear();
+
+    this->mesh_model = nullptr;
+    for (size_t i = 0; i < sizeof(mesh_models) / sizeof(mesh_models[0]); i++)
+    {
+        if (strcmp(mesh_models[i].name, meshtype) == 0)
+            this->mesh_model = &mesh_models[i];
+    }
+    if (this->mesh_model == nullptr)
+    {
+        LOG(LogLevel::INFO, "Face Mesh load failed: unknown mesh model");
+        return -1;
+    }
 
     ncnn::set_cpu_powersave(0);
     ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
 
-    faceseg.load_param("../Pkg/FaceMesh/models/faceseg-op.param");
-    faceseg.load_model("../Pkg/FaceMesh/models/faceseg-op.bin");
-    facept.load_param("../Pkg/FaceMesh/models/facemesh-op.param");
-    facept.load_model("../Pkg/FaceMesh/models/facemesh-op.bin");
+    // landmark() / seg() alone use every big core, analyze() runs both nets at once
+    // and splits the cores between them instead of oversubscribing
+    int big_cores = ncnn::get_big_cpu_count();
+    facept.opt.num_threads = big_cores;
+    faceseg.opt.num_threads = big_cores;
+    mesh_threads = std::max(1, big_cores / 2);
+    seg_threads = std::max(1, big_cores - mesh_threads);
+
+    char parampath[256];
+    char modelpath[256];
+
+    // faceseg weights are optional, seg() only fills a zero mask without them
+    snprintf(parampath, sizeof(parampath), "%s/faceseg-op.param", modeldir);
+    snprintf(modelpath, sizeof(modelpath), "%s/faceseg-op.bin", modeldir);
+    has_seg = faceseg.load_param(parampath) == 0 && faceseg.load_model(modelpath) == 0;
+    if (!has_seg)
+        faceseg.clear();
+
+    snprintf(parampath, sizeof(parampath), "%s/facemesh-%s.param", modeldir, meshtype);
+    snprintf(modelpath, sizeof(modelpath), "%s/facemesh-%s.bin", modeldir, meshtype);
+    if (facept.load_param(parampath) != 0 || facept.load_model(modelpath) != 0)
+    {
+        LOG(LogLevel::INFO, "Face Mesh load failed: facemesh model");
+        return -1;
+    }
 
 #if NCNN_VULKAN
     this->scrfd.opt.use_vulkan_compute = true;
@@ -257,13 +344,14 @@ int FaceMeshService::load(const char *modeltype)
 
     this->scrfd.opt.num_threads = ncnn::get_big_cpu_count();
 
-    char parampath[256];
-    char modelpath[256];
-    sprintf(parampath, "../Pkg/FaceMesh/models/scrfd_%s-opt2.param", modeltype);
-    sprintf(modelpath, "../Pkg/FaceMesh/models/scrfd_%s-opt2.bin", modeltype);
+    snprintf(parampath, sizeof(parampath), "%s/scrfd_%s-opt2.param", modeldir, modeltype);
+    snprintf(modelpath, sizeof(modelpath), "%s/scrfd_%s-opt2.bin", modeldir, modeltype);
 
-    this->scrfd.load_param(parampath);
-    this->scrfd.load_model(modelpath);
+    if (this->scrfd.load_param(parampath) != 0 || this->scrfd.load_model(modelpath) != 0)
+    {
+        LOG(LogLevel::INFO, "Face Mesh load failed: scrfd model");
+        return -1;
+    }
 
     has_kps = strstr(modeltype, "_kps") != NULL;
 
@@ -271,6 +359,11 @@ int FaceMeshService::load(const char *modeltype)
     return 0;
 }
 
+bool FaceMeshService::hasSeg() const
+{
+    return has_seg;
+}
+
 int FaceMeshService::detect(const cv::Mat &rgb, std::vector<FaceObjectMesh> &faceobjects, float prob_threshold, float nms_threshold)
 {
     int width = rgb.cols;
@@ -441,9 +534,10 @@ int FaceMeshService::detect(const cv::Mat &rgb, std::vector<FaceObjectMesh> &fac
     return 0;
 }
 
-void FaceMeshService::seg(cv::Mat &rgb, const FaceObjectMesh &obj, cv::Mat &mask, cv::Rect &box)
+static cv::Rect seg_box(const cv::Mat &rgb, const FaceObjectMesh &obj)
 {
     int pad = obj.rect.height;
+    cv::Rect box;
     box.x = (obj.rect.x + obj.rect.width / 2) - pad / 2 - 20;
     box.y = obj.rect.y - 80;
     box.width = obj.rect.height + 40;
@@ -454,19 +548,61 @@ void FaceMeshService::seg(cv::Mat &rgb, const FaceObjectMesh &obj, cv::Mat &mask
     box.width = box.x + box.width < rgb.cols ? box.width : rgb.cols - box.x - 1;
     box.height = box.y + box.height < rgb.rows ? box.height : rgb.rows - box.y - 1;
 
-    cv::Mat faceRoiImage = rgb(box).clone();
-    ncnn::Extractor ex_face = faceseg.create_extractor();
-    ncnn::Mat ncnn_in = ncnn::Mat::from_pixels_resize(faceRoiImage.data, ncnn::Mat::PIXEL_RGB, faceRoiImage.cols, faceRoiImage.rows, 256, 256);
+    return box;
+}
 
+static cv::Rect mesh_box(const cv::Mat &rgb, const FaceObjectMesh &obj)
+{
+    int pad = obj.rect.height;
+    cv::Rect box;
+    box.x = (obj.rect.x + obj.rect.width / 2) - pad / 2;
+    box.y = obj.rect.y;
+    box.width = obj.rect.height;
+    box.height = obj.rect.height;
+
+    box.x = std::max(0.f, (float)box.x);
+    box.y = std::max(0.f, (float)box.y);
+    box.width = box.x + box.width < rgb.cols ? box.width : rgb.cols - box.x - 1;
+    box.height = box.y + box.height < rgb.rows ? box.height : rgb.rows - box.y - 1;
+
+    return box;
+}
+
+// resize a roi of the frame straight into the network input, no intermediate clone
+// returns an empty Mat for an empty box, from_pixels_roi_resize would only log and do the same
+static ncnn::Mat roi_input(const cv::Mat &rgb, const cv::Rect &box, int target_size)
+{
+    if (rgb.empty() || box.width <= 0 || box.height <= 0)
+        return ncnn::Mat();
+
+    return ncnn::Mat::from_pixels_roi_resize(rgb.data, ncnn::Mat::PIXEL_RGB, rgb.cols, rgb.rows, (int)rgb.step, box.x, box.y, box.width, box.height, target_size, target_size);
+}
+
+// false when the mask could not be inferred, it is then all zero
+bool FaceMeshService::segInfer(ncnn::Mat &ncnn_in, cv::Mat &mask, int num_threads)
+{
+    if (!has_seg || ncnn_in.empty())
+    {
+        mask.setTo(0);
+        return false;
+    }
+
+    ncnn::Extractor ex_face = faceseg.create_extractor();
+    if (num_threads > 0)
+        ex_face.set_num_threads(num_threads);
     ncnn_in.substract_mean_normalize(meanVals, normVals);
     ex_face.input("input", ncnn_in);
     ncnn::Mat ncnn_out;
-    ex_face.extract("output", ncnn_out);
+    int h = mask.rows;
+    int w = mask.cols;
+    if (ex_face.extract("output", ncnn_out) != 0 || ncnn_out.empty() || ncnn_out.w != w || ncnn_out.h != h || ncnn_out.c < 8)
+    {
+        mask.setTo(0);
+        return false;
+    }
     float *scoredata = (float *)ncnn_out.data;
 
     unsigned char *maskIndex = mask.data;
-    int h = mask.rows;
-    int w = mask.cols;
     for (int i = 0; i < h; i++)
     {
         for (int j = 0; j < w; j++)
@@ -484,43 +620,101 @@ void FaceMeshService::seg(cv::Mat &rgb, const FaceObjectMesh &obj, cv::Mat &mask
             maskIndex[i * w + j] = maxk;
         }
     }
-    // cv::resize(mask,mask,faceRoiImage.size(),0,0,cv::INTER_NEAREST);
+
+    return true;
 }
 
-void FaceMeshService::landmark(cv::Mat &rgb, const FaceObjectMesh &obj, std::vector<cv::Point2f> &landmarks)
+void FaceMeshService::meshInfer(ncnn::Mat &ncnn_in, const cv::Rect &box, std::vector<cv::Point2f> &landmarks, int num_threads)
 {
-    int pad = obj.rect.height;
-    cv::Rect box;
-
-    box.x = (obj.rect.x + obj.rect.width / 2) - pad / 2;
-    box.y = obj.rect.y;
-    box.width = obj.rect.height;
-    box.height = obj.rect.height;
-
-    box.x = std::max(0.f, (float)box.x);
-    box.y = std::max(0.f, (float)box.y);
-    box.width = box.x + box.width < rgb.cols ? box.width : rgb.cols - box.x - 1;
-    box.height = box.y + box.height < rgb.rows ? box.height : rgb.rows - box.y - 1;
+    if (mesh_model == nullptr || ncnn_in.empty())
+        return;
 
-    cv::Mat faceRoiImage = rgb(box).clone();
+    const MeshModelInfo &info = *mesh_model;
     ncnn::Extractor ex_face = facept.create_extractor();
-    ncnn::Mat ncnn_in = ncnn::Mat::from_pixels_resize(faceRoiImage.data, ncnn::Mat::PIXEL_RGB, faceRoiImage.cols, faceRoiImage.rows, 192, 192);
-    const float means[3] = {127.5f, 127.5f, 127.5f};
-    const float norms[3] = {1 / 127.5f, 1 / 127.5f, 1 / 127.5f};
+    if (num_threads > 0)
+        ex_face.set_num_threads(num_threads);
+    const float means[3] = {info.mean, info.mean, info.mean};
+    const float norms[3] = {info.norm, info.norm, info.norm};
     ncnn_in.substract_mean_normalize(means, norms);
-    ex_face.input("input.1", ncnn_in);
+    ex_face.input(info.input, ncnn_in);
     ncnn::Mat ncnn_out;
-    ex_face.extract("482", ncnn_out);
+    if (ex_face.extract(info.output, ncnn_out) != 0 || ncnn_out.empty() || ncnn_out.total() < (size_t)468 * info.stride)
+        return;
     float *scoredata = (float *)ncnn_out.data;
+    // the crop is resized to a square input, so x and y have their own scale when the box was clamped
     for (int i = 0; i < 468; i++)
     {
         cv::Point2f pt;
-        pt.x = scoredata[i * 3] * box.width / 192 + box.x;
-        pt.y = scoredata[i * 3 + 1] * box.width / 192 + box.y;
+        pt.x = scoredata[i * info.stride] * box.width / info.coord_scale + box.x;
+        pt.y = scoredata[i * info.stride + 1] * box.height / info.coord_scale + box.y;
         landmarks.push_back(pt);
     }
 }
 
+void FaceMeshService::seg(cv::Mat &rgb, const FaceObjectMesh &obj, cv::Mat &mask, cv::Rect &box)
+{
+    box = seg_box(rgb, obj);
+
+    ncnn::Mat ncnn_in = roi_input(rgb, box, 256);
+    segInfer(ncnn_in, mask);
+}
+
+void FaceMeshService::landmark(cv::Mat &rgb, const FaceObjectMesh &obj, std::vector<cv::Point2f> &landmarks)
+{
+    if (mesh_model == nullptr)
+        return;
+
+    cv::Rect box = mesh_box(rgb, obj);
+
+    ncnn::Mat ncnn_in = roi_input(rgb, box, mesh_model->size);
+    meshInfer(ncnn_in, box, landmarks);
+}
+
+void FaceMeshService::analyze(const cv::Mat &rgb, const FaceObjectMesh &obj, FaceAnalysis &result)
+{
+    if (result.mask.rows != 256 || result.mask.cols != 256 || result.mask.type() != CV_8UC1)
+        result.mask.create(256, 256, CV_8UC1);
+
+    result.landmarks.clear();
+    result.landmarks.reserve(468);
+    result.has_mask = false;
+
+    // both boxes come from the same face rect and read the same frame pixels in place
+    result.mask_box = seg_box(rgb, obj);
+    cv::Rect box = mesh_box(rgb, obj);
+
+    ncnn::Mat seg_in = roi_input(rgb, result.mask_box, 256);
+    ncnn::Mat mesh_in = mesh_model ? roi_input(rgb, box, mesh_model->size) : ncnn::Mat();
+
+    // only one net to run: no handoff, it keeps every core like landmark() / seg() alone
+    if (!has_seg || mesh_model == nullptr)
+    {
+        result.has_mask = segInfer(seg_in, result.mask);
+        meshInfer(mesh_in, box, result.landmarks);
+        return;
+    }
+
+    // one fused call at a time, the worker holds a single job
+    std::lock_guard<std::mutex> analyze_lock(analyze_mutex);
+
+    // faceseg and facept are independent nets, run them side by side on split cores
+    bool has_mask = false;
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        if (!worker.joinable())
+            worker = std::thread(&FaceMeshService::workerLoop, this);
+        worker_job = [&]() { has_mask = segInfer(seg_in, result.mask, seg_threads); };
+        worker_done = false;
+    }
+    worker_cv.notify_all();
+
+    meshInfer(mesh_in, box, result.landmarks, mesh_threads);
+
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    worker_cv.wait(lock, [this]() { return worker_done; });
+    result.has_mask = has_mask;
+}
+
 static double calc_distange(cv::Point2f p1, cv::Point2f p2)
 {
     auto dist = sqrt((p1.x - p2.x) * (p1.x - p2.x) + (p1.y - p2.y) * (p1.y - p2.y));
@@ -588,6 +782,10 @@ ORIENTATION_t FaceMeshService::detectFacialOrientation(const cv::Mat &img)
     if (faceobjects.size() > 0)
     {
         FaceMeshService::getInstance()->landmark(img2, faceobjects[0], pts);
+        if (pts.size() < 468)
+        {
+            return orientation;
+        }
 
         auto left = calc_distange(pts[5], pts[234]);
         auto right = calc_distange(pts[5], pts[454]);
@@ -624,3 +822,59 @@ ORIENTATION_t FaceMeshService::detectFacialOrientation(const cv::Mat &img)
 
     return orientation;
 }
+
+SHM_PROCESS_t FaceMeshService::processShm(ShmRing &frames, ShmRing &results, bool with_mesh, float prob_threshold, float nms_threshold)
+{
+    if (results.slotSize() < sizeof(ShmFaceResult))
+        return SHM_PROCESS_t::SHM_PROCESS_ERROR;
+
+    uint64_t seq = 0;
+    const void *in = frames.beginRead(seq);
+    if (in == nullptr)
+        return SHM_PROCESS_t::SHM_PROCESS_IDLE;
+
+    // read the frame in place, the view is only valid until endRead()
+    cv::Mat rgb = shmFrameReadView(in, frames.slotSize());
+    if (rgb.empty())
+    {
+        // drop it, otherwise one bad header blocks the ring for good
+        frames.endRead();
+        return SHM_PROCESS_t::SHM_PROCESS_BAD_FRAME;
+    }
+
+    // output ring full, leave the frame pending so nothing is dropped silently
+    ShmFaceResult *out = (ShmFaceResult *)results.beginWrite();
+    if (out == nullptr)
+        return SHM_PROCESS_t::SHM_PROCESS_BUSY;
+
+    std::vector<FaceObjectMesh> faceobjects;
+    detect(rgb, faceobjects, prob_threshold, nms_threshold);
+
+    int face_count = std::min((int)faceobjects.size(), SHM_MAX_FACES);
+    out->frame_seq = seq;
+    out->face_count = face_count;
+    out->detected_count = (int)faceobjects.size();
+    out->has_mesh = with_mesh ? 1 : 0;
+    out->reserved = 0;
+    for (int i = 0; i < face_count; i++)
+    {
+        out->faces[i] = faceobjects[i];
+
+        if (with_mesh)
+        {
+            std::vector<cv::Point2f> pts;
+            pts.reserve(SHM_MESH_POINTS);
+            landmark(rgb, faceobjects[i], pts);
+            size_t n = std::min(pts.size(), (size_t)SHM_MESH_POINTS);
+            std::copy(pts.begin(), pts.begin() + n, out->mesh[i]);
+            std::fill(out->mesh[i] + n, out->mesh[i] + SHM_MESH_POINTS, cv::Point2f());
+        }
+    }
+
+    // done with the frame, free its slot before publishing so a producer woken by the result
+    // (waitRead() on the result ring) also finds room for the next frame
+    frames.endRead();
+    results.endWrite();
+
+    return SHM_PROCESS_t::SHM_PROCESS_DONE;
+}
@@ -0,0 +1,325 @@
+#include "../inc/ShmRing.h"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+
+#define SHM_RING_MAGIC 0x464d5332u // "FMS2", bump when Control changes
+#define SHM_CACHE_LINE 64
+
+// the control block is shared between processes, which is only valid for address free (lock free) atomics
+// (std::atomic<T>::is_always_lock_free needs C++17, the macros carry the same guarantee)
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "std::atomic<uint32_t> must be lock free to live in shared memory");
+static_assert(sizeof(uint64_t) == sizeof(long) ? ATOMIC_LONG_LOCK_FREE == 2 : ATOMIC_LLONG_LOCK_FREE == 2, "std::atomic<uint64_t> must be lock free to live in shared memory");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32 bit ints");
+
+struct ShmRing::Control
+{
+    std::atomic<uint32_t> magic;
+    uint32_t slot_count;
+    uint64_t slot_size;
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> head; // next sequence to be written
+    std::atomic<uint32_t> written;                      // futex word, bumped by endWrite()
+    std::atomic<uint32_t> read_waiters;                 // readers sleeping on written
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> tail; // next sequence to be read
+    std::atomic<uint32_t> read;                         // futex word, bumped by endRead()
+    std::atomic<uint32_t> write_waiters;                // writers sleeping on read
+};
+
+static inline size_t align_up(size_t v, size_t a)
+{
+    return (v + a - 1) / a * a;
+}
+
+static uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// shared (not FUTEX_PRIVATE) futex ops, the word lives in a MAP_SHARED mapping of both processes
+static void futex_wait(std::atomic<uint32_t> &word, uint32_t expected, const struct timespec *timeout)
+{
+    syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// sleep on word until ready() returns non null or timeout_ms expires. The waiter count is raised
+// before word is sampled and ready() rechecked, so a bump of word after the check either makes
+// FUTEX_WAIT return at once (word changed) or sees the waiter and wakes it.
+template <typename T, typename Ready>
+static T wait_for(std::atomic<uint32_t> &word, std::atomic<uint32_t> &waiters, int timeout_ms, Ready ready)
+{
+    T ptr = ready();
+    if (ptr != nullptr || timeout_ms == 0)
+        return ptr;
+
+    uint64_t deadline = timeout_ms > 0 ? monotonic_ns() + (uint64_t)timeout_ms * 1000000ull : 0;
+    waiters.fetch_add(1);
+    while (true)
+    {
+        uint32_t value = word.load();
+        ptr = ready();
+        if (ptr != nullptr)
+            break;
+
+        struct timespec ts;
+        struct timespec *timeout = nullptr;
+        if (timeout_ms > 0)
+        {
+            uint64_t now = monotonic_ns();
+            if (now >= deadline)
+                break;
+            ts.tv_sec = (deadline - now) / 1000000000ull;
+            ts.tv_nsec = (deadline - now) % 1000000000ull;
+            timeout = &ts;
+        }
+        // woken, timed out, interrupted or word already moved: all recheck ready()
+        futex_wait(word, value, timeout);
+    }
+    waiters.fetch_sub(1);
+    return ptr;
+}
+
+ShmRing::ShmRing()
+{
+    this->ctrl = nullptr;
+    this->map_size = 0;
+    this->slot_stride = 0;
+    this->slots = 0;
+    this->slot_bytes = 0;
+    this->owner = false;
+    this->shm_name[0] = '\0';
+}
+
+ShmRing::~ShmRing()
+{
+    close();
+}
+
+int ShmRing::create(const char *name, uint32_t slot_count, size_t slot_size)
+{
+    close();
+
+    if (slot_count == 0 || slot_size == 0)
+        return -1;
+
+    size_t header = align_up(sizeof(Control), SHM_CACHE_LINE);
+    size_t stride = align_up(slot_size, SHM_CACHE_LINE);
+    if (stride < slot_size || stride > (SIZE_MAX - header) / slot_count)
+        return -1;
+    size_t total = header + stride * slot_count;
+
+    // never reuse an existing segment, a peer may still have it mapped
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, total) != 0)
+    {
+        ::close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    void *ptr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return -1;
+    }
+
+    this->ctrl = new (ptr) Control();
+    this->ctrl->slot_count = slot_count;
+    this->ctrl->slot_size = slot_size;
+    this->ctrl->head.store(0, std::memory_order_relaxed);
+    this->ctrl->tail.store(0, std::memory_order_relaxed);
+    this->ctrl->written.store(0, std::memory_order_relaxed);
+    this->ctrl->read.store(0, std::memory_order_relaxed);
+    this->ctrl->read_waiters.store(0, std::memory_order_relaxed);
+    this->ctrl->write_waiters.store(0, std::memory_order_relaxed);
+    // publish magic last so a concurrent open() never sees a half initialized ring
+    this->ctrl->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+
+    this->map_size = total;
+    this->slot_stride = stride;
+    this->slots = slot_count;
+    this->slot_bytes = slot_size;
+    this->owner = true;
+    strncpy(this->shm_name, name, sizeof(this->shm_name) - 1);
+    this->shm_name[sizeof(this->shm_name) - 1] = '\0';
+
+    return 0;
+}
+
+int ShmRing::open(const char *name)
+{
+    close();
+
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < align_up(sizeof(Control), SHM_CACHE_LINE))
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+        return -1;
+
+    Control *c = (Control *)ptr;
+    if (c->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC)
+    {
+        munmap(ptr, st.st_size);
+        return -1;
+    }
+
+    // the geometry comes from another process, check it against the mapping without overflowing
+    // and keep a local copy so a later write by the peer cannot change it under us
+    uint32_t slot_count = c->slot_count;
+    uint64_t slot_size = c->slot_size;
+    size_t header = align_up(sizeof(Control), SHM_CACHE_LINE);
+    size_t avail = (size_t)st.st_size - header;
+    size_t stride = align_up(slot_size, SHM_CACHE_LINE);
+    if (slot_count == 0 || slot_size == 0 || slot_size > avail || stride < slot_size || stride > avail / slot_count)
+    {
+        munmap(ptr, st.st_size);
+        return -1;
+    }
+
+    this->ctrl = c;
+    this->map_size = st.st_size;
+    this->slot_stride = stride;
+    this->slots = slot_count;
+    this->slot_bytes = slot_size;
+    this->owner = false;
+    strncpy(this->shm_name, name, sizeof(this->shm_name) - 1);
+    this->shm_name[sizeof(this->shm_name) - 1] = '\0';
+
+    return 0;
+}
+
+int ShmRing::unlink(const char *name)
+{
+    if (shm_unlink(name) != 0 && errno != ENOENT)
+        return -1;
+
+    return 0;
+}
+
+void ShmRing::close()
+{
+    if (this->ctrl == nullptr)
+        return;
+
+    munmap(this->ctrl, this->map_size);
+    if (this->owner)
+        shm_unlink(this->shm_name);
+
+    this->ctrl = nullptr;
+    this->map_size = 0;
+    this->slot_stride = 0;
+    this->slots = 0;
+    this->slot_bytes = 0;
+    this->owner = false;
+    this->shm_name[0] = '\0';
+}
+
+uint8_t *ShmRing::slot(uint64_t index) const
+{
+    uint8_t *base = (uint8_t *)this->ctrl + align_up(sizeof(Control), SHM_CACHE_LINE);
+    return base + (index % this->slots) * this->slot_stride;
+}
+
+void *ShmRing::beginWrite()
+{
+    if (this->ctrl == nullptr)
+        return nullptr;
+
+    uint64_t head = this->ctrl->head.load(std::memory_order_relaxed);
+    uint64_t tail = this->ctrl->tail.load(std::memory_order_acquire);
+    if (head - tail >= this->slots)
+        return nullptr;
+
+    return slot(head);
+}
+
+uint64_t ShmRing::endWrite()
+{
+    uint64_t head = this->ctrl->head.load(std::memory_order_relaxed);
+    this->ctrl->head.store(head + 1, std::memory_order_release);
+    // no syscall unless a reader sleeps in waitRead()
+    this->ctrl->written.fetch_add(1);
+    if (this->ctrl->read_waiters.load() != 0)
+        futex_wake(this->ctrl->written);
+    return head;
+}
+
+const void *ShmRing::beginRead(uint64_t &seq)
+{
+    if (this->ctrl == nullptr)
+        return nullptr;
+
+    uint64_t tail = this->ctrl->tail.load(std::memory_order_relaxed);
+    uint64_t head = this->ctrl->head.load(std::memory_order_acquire);
+    if (tail == head)
+        return nullptr;
+
+    seq = tail;
+    return slot(tail);
+}
+
+void ShmRing::endRead()
+{
+    uint64_t tail = this->ctrl->tail.load(std::memory_order_relaxed);
+    this->ctrl->tail.store(tail + 1, std::memory_order_release);
+    this->ctrl->read.fetch_add(1);
+    if (this->ctrl->write_waiters.load() != 0)
+        futex_wake(this->ctrl->read);
+}
+
+void *ShmRing::waitWrite(int timeout_ms)
+{
+    if (this->ctrl == nullptr)
+        return nullptr;
+
+    return wait_for<void *>(this->ctrl->read, this->ctrl->write_waiters, timeout_ms, [this]() { return beginWrite(); });
+}
+
+const void *ShmRing::waitRead(uint64_t &seq, int timeout_ms)
+{
+    if (this->ctrl == nullptr)
+        return nullptr;
+
+    return wait_for<const void *>(this->ctrl->written, this->ctrl->read_waiters, timeout_ms, [this, &seq]() { return beginRead(seq); });
+}
+
+size_t ShmRing::slotSize() const
+{
+    return this->slot_bytes;
+}
+
+uint32_t ShmRing::slotCount() const
+{
+    return this->slots;
+}
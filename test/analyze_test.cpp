@@ -0,0 +1,138 @@
+// analyze() against landmark() followed by seg(): same boxes, mesh and mask, for faces inside
+// the frame and faces cut by its edges, over repeated calls that reuse the worker thread.
+#include "FaceMeshService.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <math.h>
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(cond))                                                          \
+        {                                                                     \
+            fprintf(stderr, "%s:%d: FAIL %s\n", __FILE__, __LINE__, #cond);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+struct Reference
+{
+    std::vector<cv::Point2f> landmarks;
+    cv::Mat mask;
+    cv::Rect mask_box;
+};
+
+static FaceObjectMesh make_face(float x, float y, float w, float h)
+{
+    FaceObjectMesh obj = FaceObjectMesh();
+    obj.rect = cv::Rect_<float>(x, y, w, h);
+    obj.prob = 0.9f;
+    return obj;
+}
+
+// the split core count of analyze() may change the float summation order, so the mesh gets a
+// small tolerance and the mask a few flipped argmax ties; boxes have to match exactly
+static void compare(const FaceAnalysis &got, const Reference &ref, bool has_seg)
+{
+    CHECK(got.mask_box == ref.mask_box);
+    CHECK(got.has_mask == (has_seg && ref.mask_box.area() > 0));
+
+    CHECK(got.landmarks.size() == ref.landmarks.size());
+    float max_diff = 0.f;
+    for (size_t i = 0; i < got.landmarks.size() && i < ref.landmarks.size(); i++)
+    {
+        max_diff = std::max(max_diff, fabsf(got.landmarks[i].x - ref.landmarks[i].x));
+        max_diff = std::max(max_diff, fabsf(got.landmarks[i].y - ref.landmarks[i].y));
+    }
+    CHECK(max_diff <= 1e-3f);
+
+    CHECK(got.mask.rows == 256 && got.mask.cols == 256 && got.mask.type() == CV_8UC1);
+    if (got.mask.rows == ref.mask.rows && got.mask.cols == ref.mask.cols && got.mask.type() == ref.mask.type())
+    {
+        int differ = cv::countNonZero(got.mask != ref.mask);
+        CHECK(differ <= (int)ref.mask.total() / 1000);
+    }
+    if (!got.has_mask)
+        CHECK(cv::countNonZero(got.mask) == 0);
+}
+
+static bool same(const FaceAnalysis &a, const FaceAnalysis &b)
+{
+    if (a.mask_box != b.mask_box || a.has_mask != b.has_mask || a.landmarks.size() != b.landmarks.size())
+        return false;
+    for (size_t i = 0; i < a.landmarks.size(); i++)
+        if (a.landmarks[i] != b.landmarks[i])
+            return false;
+    return cv::countNonZero(a.mask != b.mask) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s MODEL_DIR\n", argv[0]);
+        return 2;
+    }
+
+    FaceMeshService *service = FaceMeshService::getInstance();
+    if (service->load("500m", argv[1], "op") != 0)
+    {
+        fprintf(stderr, "can't load the models from %s\n", argv[1]);
+        return 2;
+    }
+    bool has_seg = service->hasSeg();
+    if (!has_seg)
+        printf("no faceseg model, checking the mesh and the skipped mask only\n");
+
+    // fixed seed noise with some structure, the nets only need a deterministic input
+    cv::Mat rgb(480, 640, CV_8UC3);
+    cv::RNG rng(20240611);
+    rng.fill(rgb, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(rgb, rgb, cv::Size(9, 9), 0);
+
+    std::vector<FaceObjectMesh> faces;
+    faces.push_back(make_face(250.f, 150.f, 120.f, 150.f));   // inside the frame
+    faces.push_back(make_face(-30.f, -20.f, 110.f, 140.f));   // cut by the left / top edge
+    faces.push_back(make_face(560.f, 360.f, 100.f, 130.f));   // cut by the right / bottom edge
+    faces.push_back(make_face(639.f, 200.f, 40.f, 60.f));     // mesh box clamped to almost nothing
+
+    std::vector<Reference> refs(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        refs[i].mask.create(256, 256, CV_8UC1);
+        service->landmark(rgb, faces[i], refs[i].landmarks);
+        service->seg(rgb, faces[i], refs[i].mask, refs[i].mask_box);
+    }
+
+    // alternate the faces and reuse one result, so a stale mask / mesh / box from the previous
+    // face or a job left on the worker would show up as a mismatch
+    FaceAnalysis result;
+    std::vector<FaceAnalysis> first(faces.size());
+    for (int iter = 0; iter < 20; iter++)
+    {
+        size_t i = iter % faces.size();
+        service->analyze(rgb, faces[i], result);
+        compare(result, refs[i], has_seg);
+
+        // same input and thread split: repeated calls are bit exact
+        if (iter < (int)faces.size())
+        {
+            first[i] = result;
+            first[i].mask = result.mask.clone();
+        }
+        else
+        {
+            CHECK(same(result, first[i]));
+        }
+    }
+
+    if (failures)
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    else
+        printf("all analyze checks passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+// Golden output test: detections, 468 point mesh and (when faceseg weights are present)
+// seg masks on a fixed image set, compared against recorded outputs with per-output tolerances.
+// Run with --record to (re)generate the goldens of one detector / mesh combination.
+#include "FaceMeshService.h"
+#include "test_common.h"
+
+#include <math.h>
+
+struct GoldenFace
+{
+    FaceObjectMesh obj;
+    std::vector<cv::Point2f> mesh;
+    cv::Mat mask;
+};
+
+static void run_model(FaceMeshService *service, cv::Mat &rgb, std::vector<GoldenFace> &faces)
+{
+    std::vector<FaceObjectMesh> faceobjects;
+    service->detect(rgb, faceobjects);
+
+    faces.resize(faceobjects.size());
+    for (size_t i = 0; i < faceobjects.size(); i++)
+    {
+        faces[i].obj = faceobjects[i];
+        service->landmark(rgb, faceobjects[i], faces[i].mesh);
+
+        if (service->hasSeg())
+        {
+            cv::Rect box;
+            faces[i].mask.create(256, 256, CV_8UC1);
+            service->seg(rgb, faceobjects[i], faces[i].mask, box);
+        }
+    }
+}
+
+static std::string mask_path(const std::string &dir, const std::string &stem, size_t i)
+{
+    return dir + "/" + stem + "_seg" + std::to_string(i) + ".png";
+}
+
+static bool write_golden(const std::string &dir, const std::string &stem, const std::vector<GoldenFace> &faces)
+{
+    std::string path = dir + "/" + stem + ".txt";
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "faces %d\n", (int)faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const FaceObjectMesh &obj = faces[i].obj;
+        fprintf(fp, "face %.4f %.4f %.4f %.4f %.6f\n", obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height, obj.prob);
+        fprintf(fp, "mesh %d", (int)faces[i].mesh.size());
+        for (size_t k = 0; k < faces[i].mesh.size(); k++)
+            fprintf(fp, " %.4f %.4f", faces[i].mesh[k].x, faces[i].mesh[k].y);
+        fprintf(fp, "\n");
+
+        if (!faces[i].mask.empty())
+            cv::imwrite(mask_path(dir, stem, i), faces[i].mask);
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool read_golden(const std::string &dir, const std::string &stem, std::vector<GoldenFace> &faces)
+{
+    std::string path = dir + "/" + stem + ".txt";
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp)
+        return false;
+
+    int count = 0;
+    bool ok = fscanf(fp, " faces %d", &count) == 1 && count >= 0;
+    faces.resize(ok ? count : 0);
+    for (int i = 0; ok && i < count; i++)
+    {
+        FaceObjectMesh &obj = faces[i].obj;
+        int points = 0;
+        ok = fscanf(fp, " face %f %f %f %f %f", &obj.rect.x, &obj.rect.y, &obj.rect.width, &obj.rect.height, &obj.prob) == 5 && fscanf(fp, " mesh %d", &points) == 1 && points >= 0;
+        faces[i].mesh.resize(ok ? points : 0);
+        for (int k = 0; ok && k < points; k++)
+            ok = fscanf(fp, " %f %f", &faces[i].mesh[k].x, &faces[i].mesh[k].y) == 2;
+
+        std::string mpath = mask_path(dir, stem, i);
+        if (ok && test_file_exists(mpath))
+            faces[i].mask = cv::imread(mpath, cv::IMREAD_GRAYSCALE);
+    }
+    fclose(fp);
+    return ok;
+}
+
+// worst deviation of each output over all faces of one image
+struct GoldenDiff
+{
+    float rect = 0.f;
+    float prob = 0.f;
+    float mesh = 0.f;
+    float seg = 0.f;
+};
+
+static bool compare(const std::vector<GoldenFace> &golden, const std::vector<GoldenFace> &faces, const TestArgs &args, GoldenDiff &diff)
+{
+    if (golden.size() != faces.size())
+    {
+        printf("    face count %d, golden %d\n", (int)faces.size(), (int)golden.size());
+        return false;
+    }
+
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const cv::Rect_<float> &a = faces[i].obj.rect;
+        const cv::Rect_<float> &b = golden[i].obj.rect;
+        diff.rect = std::max(diff.rect, std::max(std::max(fabsf(a.x - b.x), fabsf(a.y - b.y)), std::max(fabsf(a.width - b.width), fabsf(a.height - b.height))));
+        diff.prob = std::max(diff.prob, fabsf(faces[i].obj.prob - golden[i].obj.prob));
+
+        if (faces[i].mesh.size() != golden[i].mesh.size())
+        {
+            printf("    face %d mesh points %d, golden %d\n", (int)i, (int)faces[i].mesh.size(), (int)golden[i].mesh.size());
+            return false;
+        }
+        for (size_t k = 0; k < faces[i].mesh.size(); k++)
+        {
+            float dx = faces[i].mesh[k].x - golden[i].mesh[k].x;
+            float dy = faces[i].mesh[k].y - golden[i].mesh[k].y;
+            diff.mesh = std::max(diff.mesh, sqrtf(dx * dx + dy * dy));
+        }
+
+        // seg is only compared when both sides have a mask, faceseg weights are optional
+        if (!faces[i].mask.empty() && !golden[i].mask.empty())
+        {
+            if (faces[i].mask.size() != golden[i].mask.size())
+            {
+                printf("    face %d mask size differs from golden\n", (int)i);
+                return false;
+            }
+            float changed = (float)cv::countNonZero(faces[i].mask != golden[i].mask) / faces[i].mask.total();
+            diff.seg = std::max(diff.seg, changed);
+        }
+    }
+
+    return diff.rect <= args.tol_rect && diff.prob <= args.tol_prob && diff.mesh <= args.tol_mesh && diff.seg <= args.tol_seg;
+}
+
+int main(int argc, char **argv)
+{
+    TestArgs args;
+    if (!test_parse_args(argc, argv, args))
+    {
+        test_usage(argv[0]);
+        return 2;
+    }
+
+    FaceMeshService *service = FaceMeshService::getInstance();
+    if (service->load(args.detector.c_str(), args.models.c_str(), args.mesh.c_str()) != 0)
+    {
+        fprintf(stderr, "can't load %s from %s\n", test_variant(args).c_str(), args.models.c_str());
+        return 2;
+    }
+    if (!service->hasSeg())
+        printf("faceseg weights not found, seg outputs are not checked\n");
+
+    std::string dir = args.data + "/" + test_variant(args);
+    if (args.record && !test_mkdirs(dir))
+    {
+        fprintf(stderr, "can't create %s\n", dir.c_str());
+        return 2;
+    }
+
+    // goldens are committed with the tests, a variant without them is a failure, not a skip
+    if (!args.record && !test_file_exists(dir))
+    {
+        printf("FAIL no goldens for %s, expected in %s (record with --record)\n", test_variant(args).c_str(), dir.c_str());
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t n = 0; n < args.images.size(); n++)
+    {
+        const std::string &image = args.images[n];
+        std::string stem = test_image_stem(image);
+
+        cv::Mat rgb = test_load_rgb(image);
+        if (rgb.empty())
+        {
+            fprintf(stderr, "can't read %s\n", image.c_str());
+            return 2;
+        }
+
+        std::vector<GoldenFace> faces;
+        run_model(service, rgb, faces);
+
+        if (args.record)
+        {
+            if (!write_golden(dir, stem, faces))
+            {
+                fprintf(stderr, "can't write golden for %s\n", stem.c_str());
+                return 2;
+            }
+            printf("recorded %s: %d faces\n", stem.c_str(), (int)faces.size());
+            continue;
+        }
+
+        std::vector<GoldenFace> golden;
+        if (!read_golden(dir, stem, golden))
+        {
+            printf("FAIL %s: missing or unreadable golden in %s\n", stem.c_str(), dir.c_str());
+            failed++;
+            continue;
+        }
+
+        GoldenDiff diff;
+        bool ok = compare(golden, faces, args, diff);
+        printf("%s %s: faces %d  rect %.3f/%.3f px  prob %.4f/%.4f  mesh %.3f/%.3f px  seg %.4f/%.4f\n", ok ? "PASS" : "FAIL", stem.c_str(), (int)faces.size(), diff.rect, args.tol_rect, diff.prob, args.tol_prob, diff.mesh, args.tol_mesh, diff.seg, args.tol_seg);
+        if (!ok)
+            failed++;
+    }
+
+    return failed ? 1 : 0;
+}
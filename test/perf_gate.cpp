@@ -0,0 +1,174 @@
+// Perf gate: median latency of each pipeline stage against a recorded baseline.
+// Fails when any stage is slower than baseline * (1 + threshold / 100), or a baseline stage was not
+// timed at all. Baselines are machine specific, record them with --record on the machine that runs the gate.
+#include "FaceMeshService.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+
+struct PerfStage
+{
+    std::string name;
+    std::function<void()> run;
+};
+
+static double median_ms(const PerfStage &stage, int warmup, int iters)
+{
+    for (int i = 0; i < warmup; i++)
+        stage.run();
+
+    std::vector<double> times(iters);
+    for (int i = 0; i < iters; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        stage.run();
+        times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static bool read_baseline(const std::string &path, std::map<std::string, double> &baseline)
+{
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp)
+        return false;
+
+    char name[64];
+    double ms;
+    while (fscanf(fp, " %63s %lf", name, &ms) == 2)
+        baseline[name] = ms;
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    TestArgs args;
+    if (!test_parse_args(argc, argv, args))
+    {
+        test_usage(argv[0]);
+        return 2;
+    }
+
+    FaceMeshService *service = FaceMeshService::getInstance();
+    if (service->load(args.detector.c_str(), args.models.c_str(), args.mesh.c_str()) != 0)
+    {
+        fprintf(stderr, "can't load %s from %s\n", test_variant(args).c_str(), args.models.c_str());
+        return 2;
+    }
+
+    // detect on the first image, per face stages on the first face found in the set
+    cv::Mat detect_rgb = test_load_rgb(args.images[0]);
+    cv::Mat face_rgb;
+    FaceObjectMesh face;
+    for (size_t n = 0; n < args.images.size() && face_rgb.empty(); n++)
+    {
+        cv::Mat rgb = n == 0 ? detect_rgb : test_load_rgb(args.images[n]);
+        if (rgb.empty())
+        {
+            fprintf(stderr, "can't read %s\n", args.images[n].c_str());
+            return 2;
+        }
+
+        std::vector<FaceObjectMesh> faceobjects;
+        service->detect(rgb, faceobjects);
+        if (!faceobjects.empty())
+        {
+            face_rgb = rgb;
+            face = faceobjects[0];
+        }
+    }
+
+    std::vector<FaceObjectMesh> faceobjects;
+    std::vector<cv::Point2f> pts;
+    cv::Mat mask(256, 256, CV_8UC1);
+    cv::Rect box;
+    FaceAnalysis analysis;
+
+    std::vector<PerfStage> stages;
+    stages.push_back({"detect", [&]() { service->detect(detect_rgb, faceobjects); }});
+    if (!face_rgb.empty())
+    {
+        stages.push_back({"landmark", [&]() { pts.clear(); service->landmark(face_rgb, face, pts); }});
+        if (service->hasSeg())
+        {
+            stages.push_back({"seg", [&]() { service->seg(face_rgb, face, mask, box); }});
+            // same per face outputs, one after the other vs the fused concurrent call
+            stages.push_back({"landmark+seg", [&]() { pts.clear(); service->landmark(face_rgb, face, pts); service->seg(face_rgb, face, mask, box); }});
+            stages.push_back({"analyze", [&]() { service->analyze(face_rgb, face, analysis); }});
+        }
+    }
+    else
+    {
+        printf("no face in the image set, only timing detect\n");
+    }
+
+    std::map<std::string, double> current;
+    for (size_t i = 0; i < stages.size(); i++)
+        current[stages[i].name] = median_ms(stages[i], args.warmup, args.iters);
+
+    if (current.count("analyze"))
+        printf("analyze vs landmark+seg: %.2fx\n", current["landmark+seg"] / current["analyze"]);
+
+    std::string path = args.data + "/" + test_variant(args) + ".txt";
+    if (args.record)
+    {
+        FILE *fp = test_mkdirs(args.data) ? fopen(path.c_str(), "w") : nullptr;
+        if (!fp)
+        {
+            fprintf(stderr, "can't write %s\n", path.c_str());
+            return 2;
+        }
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            fprintf(fp, "%s %.4f\n", stages[i].name.c_str(), current[stages[i].name]);
+            printf("recorded %-12s %9.3f ms\n", stages[i].name.c_str(), current[stages[i].name]);
+        }
+        fclose(fp);
+        return 0;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!read_baseline(path, baseline))
+    {
+        printf("no baseline at %s\n", path.c_str());
+        for (size_t i = 0; i < stages.size(); i++)
+            printf("%-12s %9.3f ms\n", stages[i].name.c_str(), current[stages[i].name]);
+        return TEST_SKIP;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        const std::string &name = stages[i].name;
+        double ms = current[name];
+        if (baseline.find(name) == baseline.end())
+        {
+            printf("NEW  %-12s %9.3f ms (not in baseline)\n", name.c_str(), ms);
+            continue;
+        }
+
+        double base = baseline[name];
+        double change = (ms - base) / base * 100.0;
+        bool ok = ms <= base * (1.0 + args.threshold / 100.0);
+        printf("%s %-12s %9.3f ms  baseline %9.3f ms  %+6.1f%%\n", ok ? "PASS" : "FAIL", name.c_str(), ms, base, change);
+        if (!ok)
+            failed++;
+    }
+
+    // a recorded stage that did not run (no face found, no faceseg weights, ...) is not a pass
+    for (std::map<std::string, double>::const_iterator it = baseline.begin(); it != baseline.end(); ++it)
+    {
+        if (current.count(it->first))
+            continue;
+        printf("FAIL %-12s not timed  baseline %9.3f ms\n", it->first.c_str(), it->second);
+        failed++;
+    }
+
+    return failed ? 1 : 0;
+}
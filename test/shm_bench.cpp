@@ -0,0 +1,380 @@
+// Producer / consumer round trip over the shared memory rings against a unix socket baseline.
+// The producer fills a frame, the consumer (a forked process) reads every pixel and sends back
+// a small result, like processShm() does with its detections. Both transports keep the same
+// number of frames in flight and do the same work per frame, only the transport differs.
+// Both sides sleep while there is nothing to do, in the futex backed ShmRing::wait* calls and in
+// poll() / read() on the socket, so neither run measures a spinning core.
+#include "../inc/ShmRing.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+struct BenchFrame
+{
+    uint64_t seq;
+    uint64_t stamp_ns;
+    uint64_t size;
+    uint64_t reserved;
+};
+
+struct BenchResult
+{
+    uint64_t seq;
+    uint64_t stamp_ns;
+    uint64_t checksum;
+    uint64_t reserved;
+};
+
+struct BenchStats
+{
+    double elapsed_s;
+    double median_us;
+    double p99_us;
+    int errors;
+};
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// stands in for detect(): touches every byte of the frame
+static uint64_t frame_checksum(const uint8_t *data, size_t size)
+{
+    uint64_t sum = 0;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t v;
+        memcpy(&v, data + i * 8, 8);
+        sum += v;
+    }
+    for (size_t i = words * 8; i < size; i++)
+        sum += data[i];
+    return sum;
+}
+
+static uint64_t expected_checksum(uint8_t fill, size_t size)
+{
+    return (uint64_t)(size / 8) * (fill * 0x0101010101010101ull) + (uint64_t)(size % 8) * fill;
+}
+
+static bool read_full(int fd, void *buf, size_t size)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void *buf, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void summarize(std::vector<double> &rtt, BenchStats &stats)
+{
+    stats.median_us = 0;
+    stats.p99_us = 0;
+    if (rtt.empty())
+        return;
+
+    std::sort(rtt.begin(), rtt.end());
+    stats.median_us = rtt[rtt.size() / 2];
+    stats.p99_us = rtt[std::min(rtt.size() - 1, rtt.size() * 99 / 100)];
+}
+
+static int run_shm(int frames, size_t frame_size, uint32_t slots, BenchStats &stats)
+{
+    char in_name[64];
+    char out_name[64];
+    snprintf(in_name, sizeof(in_name), "/facemesh_bench_in_%d", (int)getpid());
+    snprintf(out_name, sizeof(out_name), "/facemesh_bench_out_%d", (int)getpid());
+    ShmRing::unlink(in_name);
+    ShmRing::unlink(out_name);
+
+    ShmRing in;
+    ShmRing out;
+    if (in.create(in_name, slots, sizeof(BenchFrame) + frame_size) != 0 || out.create(out_name, slots, sizeof(BenchResult)) != 0)
+    {
+        fprintf(stderr, "shm: can't create rings\n");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0)
+    {
+        // consumer process, maps the rings by name like an external service would
+        ShmRing cin;
+        ShmRing cout;
+        if (cin.open(in_name) != 0 || cout.open(out_name) != 0)
+            _exit(2);
+
+        for (int done = 0; done < frames; done++)
+        {
+            // a producer silent for this long is gone
+            uint64_t seq = 0;
+            const uint8_t *slot = (const uint8_t *)cin.waitRead(seq, 5000);
+            BenchResult *res = slot ? (BenchResult *)cout.waitWrite(5000) : nullptr;
+            if (res == nullptr)
+                _exit(3);
+
+            const BenchFrame *frame = (const BenchFrame *)slot;
+            res->seq = frame->seq;
+            res->stamp_ns = frame->stamp_ns;
+            res->checksum = frame_checksum(slot + sizeof(BenchFrame), frame->size);
+            // free the frame slot before publishing, a producer woken by the result finds room for the next frame
+            cin.endRead();
+            cout.endWrite();
+        }
+        cin.close();
+        cout.close();
+        _exit(0);
+    }
+
+    std::vector<double> rtt;
+    rtt.reserve(frames);
+    stats.errors = 0;
+
+    uint64_t start = now_ns();
+    int sent = 0;
+    while ((int)rtt.size() < frames)
+    {
+        bool progress = false;
+
+        uint8_t *slot = sent < frames ? (uint8_t *)in.beginWrite() : nullptr;
+        if (slot != nullptr)
+        {
+            // written in place, no staging buffer
+            BenchFrame *frame = (BenchFrame *)slot;
+            memset(slot + sizeof(BenchFrame), sent & 0xff, frame_size);
+            frame->seq = sent;
+            frame->size = frame_size;
+            frame->stamp_ns = now_ns();
+            in.endWrite();
+            sent++;
+            progress = true;
+        }
+
+        // ring full or everything sent: sleep until the consumer publishes a result, it frees the
+        // frame slot first so the next frame fits once the result is read
+        uint64_t seq = 0;
+        const BenchResult *res = (const BenchResult *)(progress ? out.beginRead(seq) : out.waitRead(seq, 100));
+        for (; res != nullptr; res = (const BenchResult *)out.beginRead(seq))
+        {
+            rtt.push_back((now_ns() - res->stamp_ns) / 1000.0);
+            if (res->seq != seq || res->checksum != expected_checksum(res->seq & 0xff, frame_size))
+                stats.errors++;
+            out.endRead();
+            progress = true;
+        }
+
+        if (!progress)
+        {
+            // consumer gone before all results came back
+            int status = 0;
+            if (waitpid(pid, &status, WNOHANG) == pid)
+            {
+                fprintf(stderr, "shm: consumer exited early\n");
+                return -1;
+            }
+        }
+    }
+    stats.elapsed_s = (now_ns() - start) / 1e9;
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+
+    summarize(rtt, stats);
+    return 0;
+}
+
+static int run_socket(int frames, size_t frame_size, uint32_t slots, BenchStats &stats)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return -1;
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        std::vector<uint8_t> buf(frame_size);
+        for (int done = 0; done < frames; done++)
+        {
+            BenchFrame frame;
+            if (!read_full(fds[1], &frame, sizeof(frame)) || frame.size != frame_size || !read_full(fds[1], buf.data(), frame_size))
+                _exit(2);
+
+            BenchResult res;
+            res.seq = frame.seq;
+            res.stamp_ns = frame.stamp_ns;
+            res.checksum = frame_checksum(buf.data(), frame_size);
+            res.reserved = 0;
+            if (!write_full(fds[1], &res, sizeof(res)))
+                _exit(2);
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    int fd = fds[0];
+
+    std::vector<uint8_t> buf(frame_size);
+    std::vector<double> rtt;
+    rtt.reserve(frames);
+    stats.errors = 0;
+
+    uint64_t start = now_ns();
+    int sent = 0;
+    bool failed = false;
+    while (!failed && (int)rtt.size() < frames)
+    {
+        // same in-flight window as the ring
+        if (sent < frames && sent - (int)rtt.size() < (int)slots)
+        {
+            memset(buf.data(), sent & 0xff, frame_size);
+            BenchFrame frame;
+            frame.seq = sent;
+            frame.size = frame_size;
+            frame.reserved = 0;
+            frame.stamp_ns = now_ns();
+            if (!write_full(fd, &frame, sizeof(frame)) || !write_full(fd, buf.data(), frame_size))
+            {
+                failed = true;
+                break;
+            }
+            sent++;
+        }
+
+        // drain whatever results are ready, block only when the window is full or everything is sent
+        bool must_wait = sent == frames || sent - (int)rtt.size() >= (int)slots;
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        while (poll(&pfd, 1, must_wait ? -1 : 0) > 0)
+        {
+            BenchResult res;
+            if (!read_full(fd, &res, sizeof(res)))
+            {
+                failed = true;
+                break;
+            }
+            rtt.push_back((now_ns() - res.stamp_ns) / 1000.0);
+            if (res.seq != rtt.size() - 1 || res.checksum != expected_checksum(res.seq & 0xff, frame_size))
+                stats.errors++;
+            must_wait = false;
+            if ((int)rtt.size() == frames)
+                break;
+        }
+    }
+    stats.elapsed_s = (now_ns() - start) / 1e9;
+    close(fd);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || (int)rtt.size() != frames)
+        return -1;
+
+    summarize(rtt, stats);
+    return 0;
+}
+
+static void report(const char *name, int frames, size_t frame_size, const BenchStats &stats)
+{
+    double fps = frames / stats.elapsed_s;
+    printf("%-8s %8.1f fps %9.1f MB/s   rtt median %8.1f us   p99 %8.1f us   errors %d\n", name, fps, fps * frame_size / 1e6, stats.median_us, stats.p99_us, stats.errors);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 1000;
+    int width = 640;
+    int height = 480;
+    int slots = 4;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--frames") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--width") == 0)
+            width = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--height") == 0)
+            height = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--slots") == 0)
+            slots = atoi(argv[i + 1]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--frames N] [--width W] [--height H] [--slots S]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (frames <= 0 || width <= 0 || height <= 0 || slots <= 0)
+    {
+        fprintf(stderr, "invalid arguments\n");
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t frame_size = (size_t)width * height * 3;
+    printf("%d frames of %dx%d rgb (%zu bytes), %d in flight\n", frames, width, height, frame_size, slots);
+
+    BenchStats shm_stats;
+    if (run_shm(frames, frame_size, slots, shm_stats) != 0)
+    {
+        fprintf(stderr, "shm run failed\n");
+        return 1;
+    }
+    report("shm", frames, frame_size, shm_stats);
+
+    BenchStats sock_stats;
+    if (run_socket(frames, frame_size, slots, sock_stats) != 0)
+    {
+        fprintf(stderr, "socket run failed\n");
+        return 1;
+    }
+    report("socket", frames, frame_size, sock_stats);
+
+    printf("shm speedup over socket: throughput %.2fx, median rtt %.2fx\n", sock_stats.elapsed_s / shm_stats.elapsed_s, sock_stats.median_us / std::max(shm_stats.median_us, 1e-3));
+
+    // only correctness fails the test, timings depend on the machine
+    return shm_stats.errors == 0 && sock_stats.errors == 0 ? 0 : 1;
+}
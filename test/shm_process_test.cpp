@@ -0,0 +1,124 @@
+// processShm() frame path: every return code, what happens to the pending frame, result sequence numbers.
+#include "FaceMeshService.h"
+#include "ShmFaceIO.h"
+#include "ShmRing.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(cond))                                                          \
+        {                                                                     \
+            fprintf(stderr, "%s:%d: FAIL %s\n", __FILE__, __LINE__, #cond);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+// publishes a flat gray frame, returns its sequence number
+static uint64_t push_frame(ShmRing &frames, int width, int height)
+{
+    void *slot = frames.beginWrite();
+    cv::Mat view = shmFrameWriteView(slot, frames.slotSize(), width, height);
+    view.setTo(cv::Scalar(128, 128, 128));
+    return frames.endWrite();
+}
+
+// publishes a raw header without going through shmFrameWriteView(), like a broken producer would
+static uint64_t push_header(ShmRing &frames, int width, int height, int step)
+{
+    ShmFrameInfo *info = (ShmFrameInfo *)frames.beginWrite();
+    info->width = width;
+    info->height = height;
+    info->step = step;
+    info->reserved = 0;
+    return frames.endWrite();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s MODEL_DIR\n", argv[0]);
+        return 2;
+    }
+
+    FaceMeshService *service = FaceMeshService::getInstance();
+    if (service->load("500m", argv[1], "op") != 0)
+    {
+        fprintf(stderr, "can't load the models from %s\n", argv[1]);
+        return 2;
+    }
+
+    std::string frames_name = "/facemesh_process_test_frames_" + std::to_string(getpid());
+    std::string results_name = "/facemesh_process_test_results_" + std::to_string(getpid());
+    ShmRing::unlink(frames_name.c_str());
+    ShmRing::unlink(results_name.c_str());
+
+    const int max_w = 320;
+    const int max_h = 240;
+    ShmRing frames;
+    ShmRing results;
+    if (frames.create(frames_name.c_str(), 4, shmFrameSlotSize(max_w, max_h)) != 0 || results.create(results_name.c_str(), 1, sizeof(ShmFaceResult)) != 0)
+    {
+        fprintf(stderr, "can't create the rings\n");
+        return 2;
+    }
+
+    uint64_t seq = 0;
+
+    // nothing pending
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_IDLE);
+
+    // header larger than the slot: dropped, the ring moves on
+    push_header(frames, max_w * 2, max_h, max_w * 2 * 3);
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_BAD_FRAME);
+    CHECK(frames.beginRead(seq) == nullptr);
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_IDLE);
+
+    // padded rows, detect() reads the pixels without a stride
+    push_header(frames, 100, 100, 100 * 3 + 4);
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_BAD_FRAME);
+    CHECK(frames.beginRead(seq) == nullptr);
+
+    // good frame, the result carries its sequence number
+    uint64_t first = push_frame(frames, max_w, max_h);
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_DONE);
+    CHECK(frames.beginRead(seq) == nullptr);
+
+    // the single result slot is still unread: the next frame waits, nothing is dropped
+    uint64_t second = push_frame(frames, max_w, max_h);
+    CHECK(second == first + 1);
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_BUSY);
+    CHECK(frames.beginRead(seq) != nullptr && seq == second);
+
+    const ShmFaceResult *res = (const ShmFaceResult *)results.beginRead(seq);
+    CHECK(res != nullptr);
+    if (res != nullptr)
+    {
+        CHECK(res->frame_seq == first);
+        CHECK(res->face_count == 0 && res->detected_count == 0);
+        CHECK(res->has_mesh == 1);
+        results.endRead();
+    }
+
+    // room again, the pending frame goes through
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_DONE);
+    res = (const ShmFaceResult *)results.beginRead(seq);
+    CHECK(res != nullptr && res->frame_seq == second);
+    if (res != nullptr)
+        results.endRead();
+    CHECK(service->processShm(frames, results) == SHM_PROCESS_t::SHM_PROCESS_IDLE);
+
+    if (failures)
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    else
+        printf("all processShm checks passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,174 @@
+// ShmRing blocking calls: timeouts, nothing consumed by a wait, wake ups across processes.
+#include "../inc/ShmRing.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(cond))                                                          \
+        {                                                                     \
+            fprintf(stderr, "%s:%d: FAIL %s\n", __FILE__, __LINE__, #cond);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// empty ring: waitRead() gives up after about timeout_ms, a zero timeout does not sleep
+static void test_read_timeout(const char *name)
+{
+    ShmRing ring;
+    CHECK(ring.create(name, 2, 64) == 0);
+
+    uint64_t seq = 0;
+    double start = now_ms();
+    CHECK(ring.waitRead(seq, 50) == nullptr);
+    double waited = now_ms() - start;
+    CHECK(waited >= 45 && waited < 1000);
+
+    start = now_ms();
+    CHECK(ring.waitRead(seq, 0) == nullptr);
+    CHECK(now_ms() - start < 45);
+}
+
+// full ring: waitWrite() times out, and returns at once when a slot is free
+static void test_write_timeout(const char *name)
+{
+    ShmRing ring;
+    CHECK(ring.create(name, 1, 64) == 0);
+
+    CHECK(ring.waitWrite(10) != nullptr);
+    ring.endWrite();
+
+    double start = now_ms();
+    CHECK(ring.waitWrite(50) == nullptr);
+    CHECK(now_ms() - start >= 45);
+
+    uint64_t seq = 0;
+    CHECK(ring.beginRead(seq) != nullptr);
+    ring.endRead();
+    CHECK(ring.waitWrite(0) != nullptr);
+}
+
+// a wait hands out the slot like beginRead(), it is consumed only by endRead()
+static void test_wait_does_not_consume(const char *name)
+{
+    ShmRing ring;
+    CHECK(ring.create(name, 2, 64) == 0);
+
+    char *slot = (char *)ring.beginWrite();
+    CHECK(slot != nullptr);
+    strcpy(slot, "frame0");
+    CHECK(ring.endWrite() == 0);
+
+    uint64_t seq = 99;
+    const char *a = (const char *)ring.waitRead(seq, 10);
+    CHECK(a != nullptr && seq == 0 && strcmp(a, "frame0") == 0);
+    const char *b = (const char *)ring.waitRead(seq, 10);
+    CHECK(b == a && seq == 0);
+
+    ring.endRead();
+    CHECK(ring.waitRead(seq, 0) == nullptr);
+}
+
+// reader sleeps in another process until the writer publishes, and the writer sleeps until the
+// reader frees the only slot, both through the futex words in the shared control block
+static void test_cross_process(const char *in_name, const char *out_name)
+{
+    const int frames = 50;
+    ShmRing in;
+    ShmRing out;
+    CHECK(in.create(in_name, 1, 64) == 0);
+    CHECK(out.create(out_name, 1, 64) == 0);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        CHECK(pid >= 0);
+        return;
+    }
+
+    if (pid == 0)
+    {
+        ShmRing cin;
+        ShmRing cout;
+        if (cin.open(in_name) != 0 || cout.open(out_name) != 0)
+            _exit(2);
+
+        for (int i = 0; i < frames; i++)
+        {
+            uint64_t seq = 0;
+            const int *frame = (const int *)cin.waitRead(seq, 5000);
+            int *res = frame ? (int *)cout.waitWrite(5000) : nullptr;
+            if (res == nullptr || seq != (uint64_t)i || *frame != i)
+                _exit(3);
+
+            *res = *frame * 2;
+            cin.endRead();
+            cout.endWrite();
+        }
+        _exit(0);
+    }
+
+    // the child starts waiting before anything is written, the first frame has to wake it
+    usleep(20000);
+    int received = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        int *frame = (int *)in.waitWrite(5000);
+        CHECK(frame != nullptr);
+        if (frame == nullptr)
+            break;
+        *frame = i;
+        in.endWrite();
+
+        uint64_t seq = 0;
+        const int *res = (const int *)out.waitRead(seq, 5000);
+        CHECK(res != nullptr && seq == (uint64_t)i && *res == i * 2);
+        if (res == nullptr)
+            break;
+        out.endRead();
+        received++;
+    }
+    CHECK(received == frames);
+
+    if (received != frames)
+        kill(pid, SIGKILL);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main()
+{
+    char names[5][64];
+    for (int i = 0; i < 5; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "/facemesh_ring_test_%d_%d", (int)getpid(), i);
+        ShmRing::unlink(names[i]);
+    }
+
+    test_read_timeout(names[0]);
+    test_write_timeout(names[1]);
+    test_wait_does_not_consume(names[2]);
+    test_cross_process(names[3], names[4]);
+
+    if (failures)
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    else
+        printf("all ring checks passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+#ifndef FACEMESH_TEST_COMMON_H
+#define FACEMESH_TEST_COMMON_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+// ctest SKIP_RETURN_CODE, used by perf_gate when no baseline has been recorded on this machine
+#define TEST_SKIP 77
+
+struct TestArgs
+{
+    std::string models;
+    std::string data;      // golden or baseline directory
+    std::string detector = "500m";
+    std::string mesh = "op";
+    std::vector<std::string> images;
+    bool record = false;
+
+    // golden tolerances, per output
+    float tol_rect = 1.0f;  // px, each of x / y / w / h
+    float tol_prob = 0.01f; // absolute score
+    float tol_mesh = 1.5f;  // px, distance per mesh point
+    float tol_seg = 0.01f;  // fraction of mask pixels with a different label
+
+    // perf gate
+    int iters = 20;
+    int warmup = 3;
+    float threshold = 10.f; // allowed median regression in percent
+};
+
+static inline void test_usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s --models DIR --data DIR [--detector 500m|1g] [--mesh op|op2] [--record]\n"
+                    "       [--tol-rect PX] [--tol-prob P] [--tol-mesh PX] [--tol-seg FRAC]\n"
+                    "       [--iters N] [--warmup N] [--threshold PCT] image...\n",
+            prog);
+}
+
+static inline bool test_parse_args(int argc, char **argv, TestArgs &args)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(a, "--record") == 0)
+            args.record = true;
+        else if (strcmp(a, "--models") == 0 && has_value)
+            args.models = argv[++i];
+        else if (strcmp(a, "--data") == 0 && has_value)
+            args.data = argv[++i];
+        else if (strcmp(a, "--detector") == 0 && has_value)
+            args.detector = argv[++i];
+        else if (strcmp(a, "--mesh") == 0 && has_value)
+            args.mesh = argv[++i];
+        else if (strcmp(a, "--tol-rect") == 0 && has_value)
+            args.tol_rect = atof(argv[++i]);
+        else if (strcmp(a, "--tol-prob") == 0 && has_value)
+            args.tol_prob = atof(argv[++i]);
+        else if (strcmp(a, "--tol-mesh") == 0 && has_value)
+            args.tol_mesh = atof(argv[++i]);
+        else if (strcmp(a, "--tol-seg") == 0 && has_value)
+            args.tol_seg = atof(argv[++i]);
+        else if (strcmp(a, "--iters") == 0 && has_value)
+            args.iters = atoi(argv[++i]);
+        else if (strcmp(a, "--warmup") == 0 && has_value)
+            args.warmup = atoi(argv[++i]);
+        else if (strcmp(a, "--threshold") == 0 && has_value)
+            args.threshold = atof(argv[++i]);
+        else if (a[0] == '-')
+            return false;
+        else
+            args.images.push_back(a);
+    }
+
+    return !args.models.empty() && !args.data.empty() && !args.images.empty() && args.iters > 0;
+}
+
+// "500m_op", one golden / baseline set per model combination
+static inline std::string test_variant(const TestArgs &args)
+{
+    return args.detector + "_" + args.mesh;
+}
+
+static inline std::string test_image_stem(const std::string &path)
+{
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static inline bool test_mkdirs(const std::string &dir)
+{
+    for (size_t pos = 1; pos <= dir.size(); pos++)
+    {
+        if (pos != dir.size() && dir[pos] != '/')
+            continue;
+        std::string sub = dir.substr(0, pos);
+        if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+static inline bool test_file_exists(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// FaceMeshService works on rgb frames
+static inline cv::Mat test_load_rgb(const std::string &path)
+{
+    cv::Mat bgr = cv::imread(path, cv::IMREAD_COLOR);
+    if (bgr.empty())
+        return bgr;
+
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    return rgb;
+}
+
+#endif // FACEMESH_TEST_COMMON_H
@@ -0,0 +1,336 @@
+"""Reference runner for the ncnn models of this repo.
+
+Translates an ncnn .param/.bin pair into an ONNX graph and runs it with
+onnxruntime, plus a port of ncnn's from_pixels_resize bilinear (fixed point)
+so the inputs match what ncnn feeds the nets bit for bit. Only covers the layers
+and weight encodings (fp32 / fp16 / 8 bit table) used by the models in ./models.
+"""
+import struct
+
+import numpy as np
+import onnx
+from onnx import TensorProto, helper, numpy_helper
+import onnxruntime as ort
+
+
+# ---------------------------------------------------------------- param / bin
+
+def parse_param(path):
+    with open(path) as f:
+        lines = [l.split() for l in f.read().splitlines() if l.strip()]
+    assert lines[0][0] == "7767517"
+    layers = []
+    for tok in lines[2:]:
+        ltype, name = tok[0], tok[1]
+        nb, nt = int(tok[2]), int(tok[3])
+        bottoms = tok[4:4 + nb]
+        tops = tok[4 + nb:4 + nb + nt]
+        params = {}
+        for kv in tok[4 + nb + nt:]:
+            k, v = kv.split("=")
+            k = int(k)
+            if k <= -23300:
+                # array param
+                vals = v.split(",")[1:]
+                params[-k - 23300] = [float(x) for x in vals]
+            else:
+                params[k] = float(v) if ("." in v or "e" in v) else int(v)
+        layers.append(dict(type=ltype, name=name, bottoms=bottoms, tops=tops, p=params))
+    return layers
+
+
+class BinReader:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        self.off = 0
+
+    def raw(self, n):
+        # type 1, plain float32
+        a = np.frombuffer(self.data, dtype="<f4", count=n, offset=self.off).copy()
+        self.off += 4 * n
+        return a
+
+    def auto(self, n):
+        # type 0, 4 byte flag then fp32 / fp16 / quantized table
+        tag = struct.unpack_from("<I", self.data, self.off)[0]
+        f = self.data[self.off:self.off + 4]
+        self.off += 4
+        if tag == 0x01306B47:
+            a = np.frombuffer(self.data, dtype="<f2", count=n, offset=self.off).astype(np.float32)
+            self.off += (2 * n + 3) // 4 * 4
+            return a
+        if tag == 0x000D4B38:
+            raise NotImplementedError("int8 weights")
+        if tag == 0x0002C056:
+            raise NotImplementedError("bf16 weights")
+        if any(f):
+            table = np.frombuffer(self.data, dtype="<f4", count=256, offset=self.off)
+            self.off += 1024
+            idx = np.frombuffer(self.data, dtype=np.uint8, count=n, offset=self.off)
+            self.off += (n + 3) // 4 * 4
+            return table[idx].astype(np.float32)
+        return self.raw(n)
+
+    def done(self):
+        return self.off == len(self.data)
+
+
+# ---------------------------------------------------------------- graph build
+
+class Builder:
+    def __init__(self):
+        self.nodes = []
+        self.inits = []
+        self.n = 0
+
+    def const(self, arr, dtype=np.float32):
+        self.n += 1
+        name = "c%d" % self.n
+        self.inits.append(numpy_helper.from_array(np.asarray(arr, dtype=dtype), name))
+        return name
+
+    def tmp(self):
+        self.n += 1
+        return "t%d" % self.n
+
+    def node(self, op, inputs, outputs=None, **attrs):
+        outputs = outputs or [self.tmp()]
+        self.nodes.append(helper.make_node(op, inputs, outputs, **attrs))
+        return outputs[0]
+
+
+def activation(b, x, out, act, actp):
+    if act == 0:
+        return b.node("Identity", [x], [out])
+    if act == 1:
+        return b.node("Relu", [x], [out])
+    if act == 2:
+        return b.node("LeakyRelu", [x], [out], alpha=float(actp[0]))
+    if act == 3:
+        return b.node("Clip", [x, b.const(actp[0]), b.const(actp[1])], [out])
+    if act == 4:
+        return b.node("Sigmoid", [x], [out])
+    raise NotImplementedError("activation %d" % act)
+
+
+def build(param_path, bin_path, input_name, input_shape, outputs):
+    layers = parse_param(param_path)
+    wb = BinReader(bin_path)
+    b = Builder()
+
+    for L in layers:
+        t, p, bot, top = L["type"], L["p"], L["bottoms"], L["tops"]
+
+        if t == "Input":
+            continue
+        elif t == "MemoryData":
+            w, h, c = p.get(0, 0), p.get(1, 0), p.get(2, 0)
+            size = w * max(h, 1) * max(c, 1)
+            data = wb.raw(size)
+            b.inits.append(numpy_helper.from_array(data, top[0]))
+        elif t == "Split":
+            for o in top:
+                b.node("Identity", [bot[0]], [o])
+        elif t in ("Convolution", "ConvolutionDepthWise"):
+            num_output = p[0]
+            kw = p.get(1, 0)
+            kh = p.get(11, kw)
+            dw = p.get(2, 1)
+            dh = p.get(12, dw)
+            sw = p.get(3, 1)
+            sh = p.get(13, sw)
+            pl = p.get(4, 0)
+            pr = p.get(15, pl)
+            pt = p.get(14, pl)
+            pb = p.get(16, pt)
+            if min(pl, pr, pt, pb) < 0:
+                raise NotImplementedError("SAME padding")
+            bias_term = p.get(5, 0)
+            wsize = p[6]
+            group = p.get(7, 1) if t == "ConvolutionDepthWise" else 1
+            act = p.get(9, 0)
+            actp = p.get(10, [])
+            if p.get(8, 0):
+                raise NotImplementedError("int8 conv")
+            w = wb.auto(wsize)
+            cin_g = wsize // (num_output * kw * kh)
+            w = w.reshape(num_output, cin_g, kh, kw)
+            ins = [bot[0], b.const(w)]
+            if bias_term:
+                ins.append(b.const(wb.raw(num_output)))
+            y = b.node("Conv", ins, None if act else [top[0]], kernel_shape=[kh, kw], strides=[sh, sw],
+                       dilations=[dh, dw], pads=[pt, pl, pb, pr], group=group)
+            if act:
+                activation(b, y, top[0], act, actp)
+        elif t == "ReLU":
+            slope = p.get(0, 0.0)
+            if slope:
+                b.node("LeakyRelu", [bot[0]], [top[0]], alpha=float(slope))
+            else:
+                b.node("Relu", [bot[0]], [top[0]])
+        elif t == "PReLU":
+            n = p.get(0, 0)
+            slope = wb.raw(n)
+            b.node("PRelu", [bot[0], b.const(slope.reshape(n, 1, 1))], [top[0]])
+        elif t == "Sigmoid":
+            b.node("Sigmoid", [bot[0]], [top[0]])
+        elif t == "GroupNorm":
+            g, c, eps = p[0], p[1], p.get(2, 1e-5)
+            affine = p.get(3, 1)
+            x = b.node("Reshape", [bot[0], b.const([1, g, -1], np.int64)])
+            mean = b.node("ReduceMean", [x, b.const([2], np.int64)], keepdims=1)
+            d = b.node("Sub", [x, mean])
+            var = b.node("ReduceMean", [b.node("Mul", [d, d]), b.const([2], np.int64)], keepdims=1)
+            std = b.node("Sqrt", [b.node("Add", [var, b.const(eps)])])
+            y = b.node("Div", [d, std])
+            shape = b.node("Shape", [bot[0]])
+            y = b.node("Reshape", [y, shape], None if affine else [top[0]])
+            if affine:
+                gamma = wb.raw(c).reshape(c, 1, 1)
+                beta = wb.raw(c).reshape(c, 1, 1)
+                y = b.node("Mul", [y, b.const(gamma)])
+                b.node("Add", [y, b.const(beta)], [top[0]])
+        elif t == "BinaryOp":
+            op = p.get(0, 0)
+            ops = {0: "Add", 1: "Sub", 2: "Mul", 3: "Div", 4: "Max", 5: "Min", 6: "Pow"}
+            if p.get(1, 0):
+                b.node(ops[op], [bot[0], b.const(p.get(2, 0.0))], [top[0]])
+            else:
+                b.node(ops[op], [bot[0], bot[1]], [top[0]])
+        elif t == "Interp":
+            rtype = p.get(0, 0)
+            hs, ws = p.get(1, 1.0), p.get(2, 1.0)
+            if rtype != 1 or p.get(3, 0) or p.get(4, 0):
+                raise NotImplementedError("Interp mode")
+            b.node("Resize", [bot[0], "", b.const([1, 1, hs, ws])], [top[0]], mode="nearest",
+                   coordinate_transformation_mode="asymmetric", nearest_mode="floor")
+        elif t == "Padding":
+            top_, bottom = p.get(0, 0), p.get(1, 0)
+            left, right = p.get(2, 0), p.get(3, 0)
+            ptype = p.get(4, 0)
+            value = p.get(5, 0.0)
+            front, behind = p.get(7, 0), p.get(8, 0)
+            # with a second bottom the pads are the ones of the param, the blob is the onnx pad constant
+            mode = {0: "constant", 1: "edge", 2: "reflect"}[ptype]
+            pads = b.const([0, front, top_, left, 0, behind, bottom, right], np.int64)
+            ins = [bot[0], pads]
+            if mode == "constant":
+                ins.append(b.const(value))
+            b.node("Pad", ins, [top[0]], mode=mode)
+        elif t == "Pooling":
+            ptype = p.get(0, 0)
+            kw = p.get(1, 0)
+            kh = p.get(11, kw)
+            sw = p.get(2, 1)
+            sh = p.get(12, sw)
+            pl = p.get(3, 0)
+            pr = p.get(14, pl)
+            pt = p.get(13, pl)
+            pb = p.get(15, pt)
+            glob = p.get(4, 0)
+            if glob:
+                b.node("GlobalMaxPool" if ptype == 0 else "GlobalAveragePool", [bot[0]], [top[0]])
+            else:
+                if pl or pr or pt or pb or p.get(5, 0) not in (0, 1):
+                    raise NotImplementedError("pooling pad")
+                b.node("MaxPool" if ptype == 0 else "AveragePool", [bot[0]], [top[0]],
+                       kernel_shape=[kh, kw], strides=[sh, sw])
+        elif t == "Reshape":
+            w, h, c = p.get(0, -233), p.get(1, -233), p.get(2, -233)
+            if w == -1 and h == -233 and c == -233:
+                b.node("Reshape", [bot[0], b.const([-1], np.int64)], [top[0]])
+            else:
+                raise NotImplementedError("Reshape %s" % p)
+        else:
+            raise NotImplementedError(t)
+
+    assert wb.done(), "weights left over: %d of %d bytes read" % (wb.off, len(wb.data))
+
+    graph = helper.make_graph(
+        b.nodes, "ncnn",
+        [helper.make_tensor_value_info(input_name, TensorProto.FLOAT, [1] + list(input_shape))],
+        [helper.make_tensor_value_info(o, TensorProto.FLOAT, None) for o in outputs],
+        b.inits)
+    model = helper.make_model(graph, opset_imports=[helper.make_opsetid("", 18)])
+    model.ir_version = 8
+    return model
+
+
+class Net:
+    def __init__(self, param_path, bin_path, input_name, outputs):
+        self.param_path, self.bin_path = param_path, bin_path
+        self.input_name, self.outputs = input_name, outputs
+        self.sessions = {}
+
+    def run(self, chw):
+        shape = chw.shape
+        if shape not in self.sessions:
+            model = build(self.param_path, self.bin_path, self.input_name, shape, self.outputs)
+            so = ort.SessionOptions()
+            so.graph_optimization_level = ort.GraphOptimizationLevel.ORT_DISABLE_ALL
+            so.log_severity_level = 3
+            self.sessions[shape] = ort.InferenceSession(model.SerializeToString(), so,
+                                                        providers=["CPUExecutionProvider"])
+        res = self.sessions[shape].run(self.outputs, {self.input_name: chw[None].astype(np.float32)})
+        return [r[0] if r.ndim == 4 else r for r in res]
+
+
+# ---------------------------------------------------------------- ncnn pixels
+
+def _coefs(src, dst):
+    scale = src / dst
+    ofs = np.empty(dst, np.int64)
+    a = np.empty((dst, 2), np.int64)
+    for d in range(dst):
+        f = np.float32((d + 0.5) * scale - 0.5)
+        s = int(np.floor(f))
+        f = np.float32(f - np.float32(s))
+        if s < 0:
+            s = 0
+            f = np.float32(0.0)
+        if s >= src - 1:
+            s = src - 2
+            f = np.float32(1.0)
+        ofs[d] = s
+        a0 = np.float32((np.float32(1.0) - f) * np.float32(2048))
+        a1 = np.float32(f * np.float32(2048))
+
+        def sat(x):
+            v = int(x + (np.float32(0.5) if x >= 0 else np.float32(-0.5)))
+            return max(min(v, 32767), -32768)
+        a[d] = (sat(a0), sat(a1))
+    return ofs, a
+
+
+def resize_bilinear_c3(src, dw, dh):
+    """ncnn::resize_bilinear_c3, scalar path"""
+    sh, sw = src.shape[:2]
+    if sw == dw and sh == dh:
+        return src.copy()
+    xofs, ia = _coefs(sw, dw)
+    yofs, ib = _coefs(sh, dh)
+    s = src.astype(np.int64)
+    # horizontal pass on every source row that is used
+    rows_needed = np.unique(np.concatenate([yofs, yofs + 1]))
+    hor = {}
+    for r in rows_needed:
+        row = s[r]
+        v = (row[xofs] * ia[:, 0:1] + row[xofs + 1] * ia[:, 1:2]) >> 4
+        hor[r] = v.astype(np.int16).astype(np.int64)
+    out = np.empty((dh, dw, 3), np.uint8)
+    for y in range(dh):
+        b0, b1 = ib[y]
+        r0, r1 = hor[yofs[y]], hor[yofs[y] + 1]
+        t0 = ((b0 * r0) >> 16).astype(np.int16).astype(np.int64)
+        t1 = ((b1 * r1) >> 16).astype(np.int16).astype(np.int64)
+        out[y] = ((t0 + t1 + 2) >> 2).astype(np.uint8)
+    return out
+
+
+def from_pixels_resize(rgb, w, h):
+    return resize_bilinear_c3(rgb, w, h).transpose(2, 0, 1).astype(np.float32)
+
+
+def substract_mean_normalize(chw, mean, norm):
+    return ((chw - np.float32(mean)) * np.float32(norm)).astype(np.float32)
@@ -0,0 +1,201 @@
+"""Record golden_test goldens without ncnn, mirroring FaceMeshService::detect / landmark.
+
+The nets run through ncnn_ref (the ncnn graphs translated to onnxruntime, inputs built with a
+port of ncnn's fixed point resize), the pre / post processing is a float32 copy of the C++ one.
+Use it where ncnn is not available, `make record_golden` records the same files from ncnn itself.
+
+    python3 test/tools/record_golden.py models test/golden/500m_op 500m test/data/*.png
+
+needs numpy, onnx, onnxruntime and pillow. The mesh model is facemesh-op, seg is not recorded.
+"""
+import os
+import sys
+
+import numpy as np
+from PIL import Image
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ncnn_ref import Net, from_pixels_resize, substract_mean_normalize
+
+f32 = np.float32
+
+
+def load_rgb(path):
+    return np.asarray(Image.open(path).convert("RGB"))
+
+
+def generate_anchors(base_size):
+    anchors = []
+    for scale in (1.0, 2.0):
+        r_w = int(round(base_size / np.sqrt(1.0)))
+        r_h = int(round(r_w * 1.0))
+        rs_w, rs_h = f32(r_w * scale), f32(r_h * scale)
+        anchors.append((-rs_w * f32(0.5), -rs_h * f32(0.5), rs_w * f32(0.5), rs_h * f32(0.5)))
+    return anchors
+
+
+def generate_proposals(anchors, stride, score, bbox, thr, out):
+    _, h, w = score.shape
+    for q, a in enumerate(anchors):
+        aw, ah = f32(a[2] - a[0]), f32(a[3] - a[1])
+        ay = f32(a[1])
+        for i in range(h):
+            ax = f32(a[0])
+            for j in range(w):
+                prob = score[q, i, j]
+                if prob >= thr:
+                    dx = f32(bbox[q * 4 + 0, i, j] * f32(stride))
+                    dy = f32(bbox[q * 4 + 1, i, j] * f32(stride))
+                    dw = f32(bbox[q * 4 + 2, i, j] * f32(stride))
+                    dh = f32(bbox[q * 4 + 3, i, j] * f32(stride))
+                    cx = f32(ax + aw * f32(0.5))
+                    cy = f32(ay + ah * f32(0.5))
+                    x0, y0 = f32(cx - dx), f32(cy - dy)
+                    x1, y1 = f32(cx + dw), f32(cy + dh)
+                    out.append([x0, y0, f32(x1 - x0 + 1), f32(y1 - y0 + 1), f32(prob)])
+                ax = f32(ax + stride)
+            ay = f32(ay + stride)
+
+
+def qsort_descent(objs, left, right):
+    i, j = left, right
+    p = objs[(left + right) // 2][4]
+    while i <= j:
+        while objs[i][4] > p:
+            i += 1
+        while objs[j][4] < p:
+            j -= 1
+        if i <= j:
+            objs[i], objs[j] = objs[j], objs[i]
+            i += 1
+            j -= 1
+    if left < j:
+        qsort_descent(objs, left, j)
+    if i < right:
+        qsort_descent(objs, i, right)
+
+
+def inter_area(a, b):
+    x0, y0 = max(a[0], b[0]), max(a[1], b[1])
+    x1, y1 = min(a[0] + a[2], b[0] + b[2]), min(a[1] + a[3], b[1] + b[3])
+    if x1 <= x0 or y1 <= y0:
+        return f32(0)
+    return f32(f32(x1 - x0) * f32(y1 - y0))
+
+
+def nms(objs, thr):
+    picked = []
+    areas = [f32(o[2] * o[3]) for o in objs]
+    for i, a in enumerate(objs):
+        keep = True
+        for j in picked:
+            inter = inter_area(a, objs[j])
+            union = f32(areas[i] + areas[j] - inter)
+            if f32(inter / union) > thr:
+                keep = False
+        if keep:
+            picked.append(i)
+    return picked
+
+
+def detect(net, rgb, prob_threshold=0.5, nms_threshold=0.45):
+    height, width = rgb.shape[:2]
+    target = 640
+    w, h = width, height
+    if w > h:
+        scale = f32(target) / f32(w)
+        w = target
+        h = int(f32(h) * scale)
+    else:
+        scale = f32(target) / f32(h)
+        h = target
+        w = int(f32(w) * scale)
+
+    chw = from_pixels_resize(rgb, w, h)
+    wpad = (w + 31) // 32 * 32 - w
+    hpad = (h + 31) // 32 * 32 - h
+    chw = np.pad(chw, ((0, 0), (hpad // 2, hpad - hpad // 2), (wpad // 2, wpad - wpad // 2)))
+    chw = substract_mean_normalize(chw, 127.5, 1 / 128.0)
+
+    outs = net.run(chw)
+    proposals = []
+    for k, (stride, base) in enumerate(((8, 16), (16, 64), (32, 256))):
+        generate_proposals(generate_anchors(base), stride, outs[2 * k], outs[2 * k + 1], prob_threshold, proposals)
+
+    if proposals:
+        qsort_descent(proposals, 0, len(proposals) - 1)
+    picked = nms(proposals, nms_threshold)
+
+    faces = []
+    for i in picked:
+        x, y, fw, fh, prob = proposals[i]
+        x0 = f32(f32(x - f32(wpad // 2)) / scale)
+        y0 = f32(f32(y - f32(hpad // 2)) / scale)
+        x1 = f32(f32(f32(x + fw) - f32(wpad // 2)) / scale)
+        y1 = f32(f32(f32(y + fh) - f32(hpad // 2)) / scale)
+        clamp = lambda v, hi: max(min(v, f32(hi - 1)), f32(0))
+        x0, y0, x1, y1 = clamp(x0, width), clamp(y0, height), clamp(x1, width), clamp(y1, height)
+        faces.append([x0, y0, f32(x1 - x0), f32(y1 - y0), prob])
+    return faces
+
+
+def mesh_box(rgb, obj):
+    rows, cols = rgb.shape[:2]
+    x, y, w, h = obj[:4]
+    pad = int(h)
+    # cv::Rect members are int, the float expressions truncate on assignment
+    bx = int(f32(x + w / f32(2)) - f32(pad // 2))
+    by = int(y)
+    bw = int(h)
+    bh = int(h)
+    bx = int(max(f32(0), f32(bx)))
+    by = int(max(f32(0), f32(by)))
+    bw = bw if bx + bw < cols else cols - bx - 1
+    bh = bh if by + bh < rows else rows - by - 1
+    return bx, by, bw, bh
+
+
+def landmark(net, rgb, obj):
+    bx, by, bw, bh = mesh_box(rgb, obj)
+    if bw <= 0 or bh <= 0:
+        return []
+    roi = rgb[by:by + bh, bx:bx + bw]
+    chw = from_pixels_resize(roi, 192, 192)
+    chw = substract_mean_normalize(chw, 127.5, 1 / 127.5)
+    out = net.run(chw)[0].reshape(-1)
+    pts = []
+    for i in range(468):
+        px = f32(f32(out[i * 3] * f32(bw)) / f32(192)) + f32(bx)
+        py = f32(f32(out[i * 3 + 1] * f32(bh)) / f32(192)) + f32(by)
+        pts.append((f32(px), f32(py)))
+    return pts
+
+
+def main():
+    if len(sys.argv) < 5:
+        print("usage: %s MODEL_DIR OUT_DIR 500m|1g image..." % sys.argv[0])
+        sys.exit(2)
+    models, out_dir, detector = sys.argv[1], sys.argv[2], sys.argv[3]
+    images = sys.argv[4:]
+    scrfd = Net("%s/scrfd_%s-opt2.param" % (models, detector), "%s/scrfd_%s-opt2.bin" % (models, detector),
+                "input.1", ["score_8", "bbox_8", "score_16", "bbox_16", "score_32", "bbox_32"])
+    mesh = Net("%s/facemesh-op.param" % models, "%s/facemesh-op.bin" % models, "input.1", ["482"])
+    os.makedirs(out_dir, exist_ok=True)
+    for image in images:
+        stem = os.path.splitext(os.path.basename(image))[0]
+        rgb = load_rgb(image)
+        faces = detect(scrfd, rgb)
+        with open(os.path.join(out_dir, stem + ".txt"), "w") as fp:
+            fp.write("faces %d\n" % len(faces))
+            for obj in faces:
+                fp.write("face %.4f %.4f %.4f %.4f %.6f\n" % tuple(float(v) for v in obj))
+                pts = landmark(mesh, rgb, obj)
+                fp.write("mesh %d" % len(pts))
+                for px, py in pts:
+                    fp.write(" %.4f %.4f" % (px, py))
+                fp.write("\n")
+        print("recorded %s: %d faces %s" % (stem, len(faces), [[round(float(v), 1) for v in f] for f in faces]))
+
+
+if __name__ == "__main__":
+    main()